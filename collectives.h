@@ -0,0 +1,573 @@
+#ifndef COLLECTIVES_H
+#define COLLECTIVES_H
+
+#include "harness.h"
+#include <numeric>
+#include <algorithm>
+
+// persistent collectives are MPI-4, or an extension in Open MPI 4.x
+#if MPI_VERSION >= 4
+#  define HAVE_PERSISTENT_COLL 1
+#  define PERSISTENT_INIT(coll) MPI_##coll##_init
+#elif defined(OPEN_MPI) && __has_include(<mpi-ext.h>)
+#  include <mpi-ext.h>
+#  if defined(OMPI_HAVE_MPI_EXT_PCOLLREQ) && OMPI_HAVE_MPI_EXT_PCOLLREQ
+#    define HAVE_PERSISTENT_COLL 1
+#    define PERSISTENT_INIT(coll) MPIX_##coll##_init
+#  endif
+#endif
+
+// Collective kernels for the harness: MPI_Alltoall, MPI_Alltoallv,
+// MPI_Alltoallw and MPI_Allreduce on bufcnt unsigned ints (per peer).
+//
+// --mode selects how each step issues the collective:
+//
+//   blocking      MPI_Alltoall(...)
+//   nonblocking   MPI_Ialltoall(...), compute, MPI_Wait
+//   persistent    MPI_Alltoall_init(...) once per size, then
+//                 MPI_Start, compute, MPI_Wait every step
+//
+// The compute in between is a dependent multiply-add chain sized to
+// take as long as the bare collective (t_pure, measured after each
+// setup), so with perfect asynchronous progress a step costs t_pure
+// and with none 2*t_pure.  As in IMB-NBC, with the compute actually
+// measured (t_cpu):
+//
+//   overlap = (t_pure + t_cpu - t_total) / min(t_pure, t_cpu)
+//
+// Persistent mode also reports the one-time init cost against the
+// per-step savings of MPI_Start over posting a fresh nonblocking call.
+namespace kernels {
+
+  using harness::Context;
+
+  //----------------------------------------------------------------
+  // mode handling shared by all the collectives.  kernels provide
+  //   void blocking ();
+  //   void ipost (MPI_Request *req);
+  //   void pinit (MPI_Request *req);   // HAVE_PERSISTENT_COLL only
+  // and forward execute()/calibrate() to issue()/calibrate_mode() below.
+  struct Collective : harness::KernelBase
+  {
+    enum Mode { BLOCKING, NONBLOCKING, PERSISTENT };
+
+    static constexpr int ncalib = 15;
+
+    Mode mode = BLOCKING;
+    MPI_Request preq = MPI_REQUEST_NULL;
+
+    double
+      rate = 0.,                        // compute iterations per second
+      t_pure = 0., t_init = 0., t_post_wait = 0., t_start_wait = 0.,
+      t_cpu = 0.;
+    std::size_t
+      compute_iters = 0,
+      ncpu = 0;
+
+    ~Collective () { if (MPI_REQUEST_NULL != preq) MPI_Request_free(&preq); }
+
+    const char * run_mode () const { return mode_name(mode); }
+
+    static const char * mode_name (const Mode m)
+    {
+      switch (m)
+        {
+        case NONBLOCKING: return "nonblocking";
+        case PERSISTENT:  return "persistent";
+        default:          return "blocking";
+        }
+    }
+
+    void configure (const Context &ctx, const harness::Options &opts)
+    {
+      mode = BLOCKING;
+      if ("nonblocking" == opts.mode) mode = NONBLOCKING;
+      if ("persistent"  == opts.mode) mode = PERSISTENT;
+
+      if (0 == ctx.myrank && !opts.mode.empty() && opts.mode != mode_name(mode))
+        std::cout << "# unknown mode \"" << opts.mode << "\", using blocking" << std::endl;
+
+#ifndef HAVE_PERSISTENT_COLL
+      if (PERSISTENT == mode)
+        {
+          if (0 == ctx.myrank)
+            std::cout << "# persistent collectives need MPI-4, using nonblocking" << std::endl;
+          mode = NONBLOCKING;
+        }
+#endif
+
+      if (BLOCKING == mode) return;
+
+      measure_rate();
+    }
+
+    // compute iterations per second; best of a few, so the compute
+    // kernel is not stretched by noise
+    void measure_rate ()
+    {
+      rate = 0.;
+      for (int i=0; i<3; i++)
+        {
+          const std::size_t n = 1 << 22;
+          const double starttime = MPI_Wtime();
+          compute(n);
+          rate = std::max(rate, n / (MPI_Wtime() - starttime));
+        }
+    }
+
+    // the "application" work between post and wait; never calls MPI.
+    static void compute (const std::size_t n)
+    {
+      volatile double seed = 1., sink;
+
+      double x = seed;
+      for (std::size_t i=0; i<n; i++)
+        x = x*0.999999 + 1.e-6;
+
+      sink = x;
+      (void) sink;
+    }
+
+    void timed_compute ()
+    {
+      const double starttime = MPI_Wtime();
+      compute(compute_iters);
+      t_cpu += MPI_Wtime() - starttime;
+      ncpu++;
+    }
+
+    void describe (const Context &, const harness::Options &, harness::Sink &sink)
+    {
+      if (!sink.active()) return;
+
+      std::ostream &os = sink.stream();
+
+      os << "# mode = " << mode_name(mode) << "\n";
+
+      if (BLOCKING == mode) return;
+
+      os << "# compute kernel = " << rate / 1.e6 << " (M iterations/sec), re-measured and sized to t_pure for every size\n"
+         << "# overlap_row=(bufsize, t_pure, t_cpu, t_total, overlap_pct, t_cpu/t_pure) (bytes, sec, sec, sec, %, -), averaged over ranks\n";
+      if (PERSISTENT == mode)
+        os << "# persistent_row=(bufsize, t_init, t_post_wait, t_start_wait, saved_per_step) (bytes, sec...), max over ranks\n";
+      os << std::flush;
+    }
+
+    // needs the kernel's bufsize (bytes per peer)
+    void report_modes (const Context &ctx, const std::size_t bufsize,
+                       const harness::StepStats &stats, harness::Sink &sink)
+    {
+      if (BLOCKING == mode) return;
+
+      double local = ncpu ? t_cpu / static_cast<double>(ncpu) : 0., cpu = 0.;
+      MPI_Reduce(&local, &cpu, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+      if (!sink.active()) return;
+
+      cpu /= static_cast<double>(ctx.nranks);
+
+      const double
+        total = stats.global.mean(),
+        shorter = std::min(t_pure, cpu),
+        overlap = (shorter > 0.) ? std::min(1., std::max(0., (t_pure + cpu - total) / shorter)) : 0.;
+
+      std::ostream &os = sink.stream();
+
+      os << "overlap_row=("
+         << bufsize << ", "
+         << t_pure << ", "
+         << cpu << ", "
+         << total << ", "
+         << 100.*overlap << ", "
+         << (t_pure > 0. ? cpu / t_pure : 0.) << ")\n";
+
+      if (PERSISTENT == mode)
+        os << "persistent_row=("
+           << bufsize << ", "
+           << t_init << ", "
+           << t_post_wait << ", "
+           << t_start_wait << ", "
+           << t_post_wait - t_start_wait << ")\n";
+
+      os << std::flush;
+    }
+  };
+
+
+
+  // one step, in the selected mode
+  template <class Kernel>
+  void issue (Kernel &k)
+  {
+    switch (k.mode)
+      {
+      case Collective::NONBLOCKING:
+        {
+          MPI_Request req;
+          k.ipost(&req);
+          k.timed_compute();
+          MPI_Wait(&req, MPI_STATUS_IGNORE);
+          break;
+        }
+      case Collective::PERSISTENT:
+        MPI_Start(&k.preq);
+        k.timed_compute();
+        MPI_Wait(&k.preq, MPI_STATUS_IGNORE);
+        break;
+      default:
+        k.blocking();
+      }
+  }
+
+
+
+  // median of a small sample
+  inline double median (std::vector<double> v)
+  {
+    std::nth_element(v.begin(), v.begin() + v.size()/2, v.end());
+    return v[v.size()/2];
+  }
+
+  // after every setup: (re)create the persistent request for the new
+  // buffers, time the bare collective and size the compute to match.
+  // post/wait and start/wait are sampled interleaved, alternating which
+  // goes first, so drift and ordering effects hit both alike; each rank
+  // takes the median and the slowest rank's counts.
+  template <class Kernel>
+  void calibrate_mode (Kernel &k)
+  {
+    if (Collective::BLOCKING == k.mode) return;
+
+    const bool persistent = (Collective::PERSISTENT == k.mode);
+    double local[3] = { 0., 0., 0. }, global[3];
+    std::vector<double> post_wait, start_wait;
+
+    k.compute_iters = 0;
+
+    // rate now, with every rank computing at once as in the steps
+    k.measure_rate();
+
+#ifdef HAVE_PERSISTENT_COLL
+    if (Collective::PERSISTENT == k.mode)
+      {
+        if (MPI_REQUEST_NULL != k.preq) MPI_Request_free(&k.preq);
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        const double starttime = MPI_Wtime();
+        k.pinit(&k.preq);
+        local[0] = MPI_Wtime() - starttime;
+      }
+#endif
+
+    auto time_post = [&k] ()
+      {
+        MPI_Request req;
+        const double starttime = MPI_Wtime();
+        k.ipost(&req);
+        MPI_Wait(&req, MPI_STATUS_IGNORE);
+        return MPI_Wtime() - starttime;
+      };
+
+    auto time_start = [&k] ()
+      {
+        const double starttime = MPI_Wtime();
+        MPI_Start(&k.preq);
+        MPI_Wait(&k.preq, MPI_STATUS_IGNORE);
+        return MPI_Wtime() - starttime;
+      };
+
+    // first of each is an untimed warmup
+    time_post();
+    if (persistent) time_start();
+
+    for (int i=0; i<Collective::ncalib; i++)
+      if (persistent && (i % 2))
+        {
+          start_wait.push_back(time_start());
+          post_wait.push_back(time_post());
+        }
+      else
+        {
+          post_wait.push_back(time_post());
+          if (persistent) start_wait.push_back(time_start());
+        }
+
+    local[1] = median(post_wait);
+    if (persistent) local[2] = median(start_wait);
+
+    MPI_Allreduce(local, global, 3, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    k.t_init = global[0], k.t_post_wait = global[1], k.t_start_wait = global[2];
+    k.t_pure = persistent ? k.t_start_wait : k.t_post_wait;
+    k.compute_iters = static_cast<std::size_t>(k.t_pure * k.rate);
+    k.t_cpu = 0., k.ncpu = 0;
+  }
+
+  //----------------------------------------------------------------
+  struct Alltoall : Collective
+  {
+    static constexpr const char *name = "alltoall";
+
+    int nranks, myrank;
+    std::size_t bufcnt;
+    std::vector<unsigned int> sbuf, rbuf;
+
+    std::size_t footprint (const Context &ctx, const std::size_t cnt) const { return ctx.nranks*cnt*elsize; }
+
+    void setup (const Context &ctx, const std::size_t cnt)
+    {
+      nranks = ctx.nranks, myrank = ctx.myrank, bufcnt = cnt;
+
+      sbuf.assign(nranks*bufcnt, 0); rbuf.assign(nranks*bufcnt, 0);
+
+      // make sure this is truly allocated before beginning by touching all elements
+      std::fill (sbuf.begin(), sbuf.end(), myrank);
+    }
+
+    void prepare (const std::size_t step)
+    {
+      std::fill (sbuf.begin(), sbuf.end(), step*nranks + myrank);
+    }
+
+    void blocking ()
+    {
+      MPI_Alltoall (&sbuf[0], bufcnt, MPI_UNSIGNED,
+                    &rbuf[0], bufcnt, MPI_UNSIGNED,
+                    MPI_COMM_WORLD);
+    }
+
+    void ipost (MPI_Request *req)
+    {
+      MPI_Ialltoall (&sbuf[0], bufcnt, MPI_UNSIGNED,
+                     &rbuf[0], bufcnt, MPI_UNSIGNED,
+                     MPI_COMM_WORLD, req);
+    }
+
+#ifdef HAVE_PERSISTENT_COLL
+    void pinit (MPI_Request *req)
+    {
+      PERSISTENT_INIT(Alltoall) (&sbuf[0], bufcnt, MPI_UNSIGNED,
+                                 &rbuf[0], bufcnt, MPI_UNSIGNED,
+                                 MPI_COMM_WORLD, MPI_INFO_NULL, req);
+    }
+#endif
+
+    void execute () { issue(*this); }
+    void calibrate (const Context &) { calibrate_mode(*this); }
+
+    void report (const Context &ctx, const harness::StepStats &stats, harness::Sink &sink)
+    {
+      report_modes(ctx, bufcnt*elsize, stats, sink);
+    }
+
+    void check (const std::size_t step) const
+    {
+      // check correctness (first few elem)
+      for (unsigned int r=0, idx=0; r<nranks; r++, idx+=bufcnt)
+        for (unsigned int c=0; c<std::min(4,(int)bufcnt); c++)
+          assert(rbuf[idx+c] == static_cast<unsigned int>(step*nranks + r));
+    }
+  };
+
+
+
+  //----------------------------------------------------------------
+  struct Alltoallv : Alltoall
+  {
+    static constexpr const char *name = "alltoallv";
+
+    // odd ranks exchange bufcnt/2, and we check the first 4 elements.
+    static constexpr std::size_t mincnt = 16;
+
+    std::vector<int> sendcounts, sdispls, recvcounts, rdispls;
+
+    void setup (const Context &ctx, const std::size_t cnt)
+    {
+      Alltoall::setup(ctx, cnt);
+
+      sendcounts.assign(/* size = */ nranks, /* value = */ bufcnt);
+      sdispls   .assign(/* size = */ nranks, /* value = */ 0);
+      recvcounts.assign(/* size = */ nranks, /* value = */ -1);
+      rdispls   .assign(/* size = */ nranks, /* value = */ -1);
+
+      std::partial_sum(sendcounts.begin(), sendcounts.end(), sdispls.begin());
+      for (std::vector<int>::iterator it=sdispls.begin(); it!=sdispls.end(); ++it)
+        *it -= bufcnt;
+
+      rdispls = sdispls;
+
+      // even ranks receive full bufcnt; odd ranks 1/2 that.
+      for (auto r=0; r<sendcounts.size(); ++r)
+        {
+          sendcounts[r] = (0 == r%2)      ? bufcnt : bufcnt/2;
+          recvcounts[r] = (0 == myrank%2) ? bufcnt : bufcnt/2;
+        }
+    }
+
+    void prepare (const std::size_t step)
+    {
+      Alltoall::prepare(step);
+      std::fill (rbuf.begin(), rbuf.end(), 0); // <-- initialize invalid
+    }
+
+    void blocking ()
+    {
+      MPI_Alltoallv (&sbuf[0], &sendcounts[0], &sdispls[0], MPI_UNSIGNED,
+                     &rbuf[0], &recvcounts[0], &rdispls[0], MPI_UNSIGNED,
+                     MPI_COMM_WORLD);
+    }
+
+    void ipost (MPI_Request *req)
+    {
+      MPI_Ialltoallv (&sbuf[0], &sendcounts[0], &sdispls[0], MPI_UNSIGNED,
+                      &rbuf[0], &recvcounts[0], &rdispls[0], MPI_UNSIGNED,
+                      MPI_COMM_WORLD, req);
+    }
+
+#ifdef HAVE_PERSISTENT_COLL
+    void pinit (MPI_Request *req)
+    {
+      PERSISTENT_INIT(Alltoallv) (&sbuf[0], &sendcounts[0], &sdispls[0], MPI_UNSIGNED,
+                                  &rbuf[0], &recvcounts[0], &rdispls[0], MPI_UNSIGNED,
+                                  MPI_COMM_WORLD, MPI_INFO_NULL, req);
+    }
+#endif
+
+    void execute () { issue(*this); }
+    void calibrate (const Context &) { calibrate_mode(*this); }
+
+    void check (const std::size_t step) const
+    {
+      // check correctness (first few elem)
+      for (auto r=0, idx=0; r<nranks; r++, idx+=bufcnt)
+        {
+          assert(rdispls[r] == sdispls[r]);
+          for (auto c=0; c<std::min(4,(int)bufcnt); c++)
+            assert(rbuf[idx+c] == static_cast<unsigned int>(step*nranks + r));
+        }
+    }
+  };
+
+
+
+  //----------------------------------------------------------------
+  struct Alltoallw : Alltoallv
+  {
+    static constexpr const char *name = "alltoallw";
+
+    std::vector<MPI_Datatype> sendtypes, recvtypes;
+
+    void setup (const Context &ctx, const std::size_t cnt)
+    {
+      Alltoallv::setup(ctx, cnt);
+
+      sendtypes.assign(/* size = */ nranks, /* value = */ MPI_DATATYPE_NULL);
+      recvtypes.assign(/* size = */ nranks, /* value = */ MPI_DATATYPE_NULL);
+
+      // for Alltoallw, the displacements are bytes, not elements
+      for (std::vector<int>::iterator it=sdispls.begin(); it!=sdispls.end(); ++it)
+        *it *= elsize;
+
+      rdispls = sdispls;
+
+      for (auto r=0; r<sendtypes.size(); ++r)
+        {
+          sendtypes[r] =  (0 == r%2)      ? MPI_UNSIGNED : MPI_INT;
+          recvtypes[r] =  (0 == myrank%2) ? MPI_UNSIGNED : MPI_INT;
+        }
+    }
+
+    void blocking ()
+    {
+      MPI_Alltoallw (&sbuf[0], &sendcounts[0], &sdispls[0], &sendtypes[0],
+                     &rbuf[0], &recvcounts[0], &rdispls[0], &recvtypes[0],
+                     MPI_COMM_WORLD);
+    }
+
+    void ipost (MPI_Request *req)
+    {
+      MPI_Ialltoallw (&sbuf[0], &sendcounts[0], &sdispls[0], &sendtypes[0],
+                      &rbuf[0], &recvcounts[0], &rdispls[0], &recvtypes[0],
+                      MPI_COMM_WORLD, req);
+    }
+
+#ifdef HAVE_PERSISTENT_COLL
+    void pinit (MPI_Request *req)
+    {
+      PERSISTENT_INIT(Alltoallw) (&sbuf[0], &sendcounts[0], &sdispls[0], &sendtypes[0],
+                                  &rbuf[0], &recvcounts[0], &rdispls[0], &recvtypes[0],
+                                  MPI_COMM_WORLD, MPI_INFO_NULL, req);
+    }
+#endif
+
+    void execute () { issue(*this); }
+    void calibrate (const Context &) { calibrate_mode(*this); }
+  };
+
+
+
+  //----------------------------------------------------------------
+  struct Allreduce : Collective
+  {
+    static constexpr const char *name = "allreduce";
+
+    static constexpr std::size_t
+      default_bufcnt = 1,
+      default_maxstep = 5e3;
+
+    int nranks, myrank;
+    std::size_t bufcnt, tag;
+    std::vector<unsigned int> sbuf, rbuf;
+
+    std::size_t footprint (const Context &, const std::size_t cnt) const { return cnt*elsize; }
+
+    void setup (const Context &ctx, const std::size_t cnt)
+    {
+      nranks = ctx.nranks, myrank = ctx.myrank, bufcnt = cnt;
+
+      sbuf.assign(bufcnt, myrank); rbuf.assign(bufcnt, 0);
+    }
+
+    void prepare (const std::size_t step)
+    {
+      // (step wraps so the largest contribution never overflows unsigned int)
+      tag = step%1024;
+      std::fill (sbuf.begin(), sbuf.end(), tag*nranks + myrank);
+    }
+
+    void blocking ()
+    {
+      MPI_Allreduce (&sbuf[0], &rbuf[0], bufcnt, MPI_UNSIGNED, MPI_MAX, MPI_COMM_WORLD);
+    }
+
+    void ipost (MPI_Request *req)
+    {
+      MPI_Iallreduce (&sbuf[0], &rbuf[0], bufcnt, MPI_UNSIGNED, MPI_MAX, MPI_COMM_WORLD, req);
+    }
+
+#ifdef HAVE_PERSISTENT_COLL
+    void pinit (MPI_Request *req)
+    {
+      PERSISTENT_INIT(Allreduce) (&sbuf[0], &rbuf[0], bufcnt, MPI_UNSIGNED, MPI_MAX,
+                                  MPI_COMM_WORLD, MPI_INFO_NULL, req);
+    }
+#endif
+
+    void execute () { issue(*this); }
+    void calibrate (const Context &) { calibrate_mode(*this); }
+
+    void report (const Context &ctx, const harness::StepStats &stats, harness::Sink &sink)
+    {
+      report_modes(ctx, bufcnt*elsize, stats, sink);
+    }
+
+    void check (const std::size_t) const
+    {
+      // check correctness (first few elem), c.f. https://study.com/learn/lesson/sum-of-arithmetic-sequence-formula-examples-what-is-arithmetic-sequence.html
+      for (unsigned int c=0; c<std::min(4,(int)bufcnt); c++)
+        assert(rbuf[c] == tag*nranks + (nranks-1));
+    }
+  };
+}
+
+#endif // COLLECTIVES_H
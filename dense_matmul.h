@@ -0,0 +1,326 @@
+#ifndef DENSE_MATMUL_H
+#define DENSE_MATMUL_H
+
+#include "harness.h"
+#include <omp.h>
+#include <sched.h>
+#include <pthread.h>
+#include <memory>
+#include <Eigen/Core>
+#include <Eigen/Dense>
+
+// Eigen dense compute kernel for the harness, meant as a node health
+// check.  Each step runs, with --threads OpenMP threads per rank:
+//
+//   - an LU solve of a fresh random matsize^2 system,
+//   - a fresh random matsize^2 matrix multiplied by itself (GEMM),
+//   - a STREAM triad over arrays well beyond cache,
+//
+// so every node gets a roofline point: GEMM GFLOPS against triad GB/s,
+// summed over its ranks.  Ranks and nodes falling short of the fleet
+// median by more than slow_threshold are flagged SLOW.
+namespace kernels {
+
+  using harness::Context;
+
+  struct DenseMatmul : harness::KernelBase
+  {
+    static constexpr const char *name = "dense_matmul";
+
+    static constexpr std::size_t
+      elsize = sizeof(double),
+      default_bufcnt = 1024*8,
+      default_maxstep = 12;
+
+    static constexpr double
+      default_maxtime = 60.*20.,
+      slow_threshold = 1.05;
+
+    static constexpr bool sweepable = false;
+
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> Matrix;
+    typedef Eigen::Matrix<double, Eigen::Dynamic, 1> Vector;
+
+    int myrank;
+    std::size_t matsize, triad_len;
+    std::vector<float> myflops, mysolveflops, mybw;
+    std::vector<int> thread_cpus;       // cpu of each OpenMP thread, after pinning
+    std::unique_ptr<double[]> ta, tb, tc;
+
+    std::size_t footprint (const Context &, const std::size_t N) const { return N*N*elsize; }
+
+    // threads per rank, and one core per thread.  OMP_PROC_BIND, if
+    // set, takes precedence over our own pinning.
+    void configure (const Context &ctx, const harness::Options &opts)
+    {
+      myrank = ctx.myrank;
+
+      if (opts.threads > 0) omp_set_num_threads(opts.threads);
+      Eigen::setNbThreads(omp_get_max_threads());
+
+      if (!std::getenv("OMP_PROC_BIND"))
+        {
+          // e.g. --cpu-bind core gives each rank one core for all its threads
+          const std::size_t ncpus = pin_threads();
+          const std::size_t nthreads = omp_get_max_threads();
+          if (0 == myrank && ncpus && nthreads > ncpus)
+            std::cout << "# *** " << nthreads << " threads per rank on " << ncpus
+                      << " launched core(s): threads share cores, launch with e.g. --cpu-bind depth -d "
+                      << nthreads << " ***" << std::endl;
+        }
+
+      thread_cpus.assign(omp_get_max_threads(), -1);
+#     pragma omp parallel
+      thread_cpus[omp_get_thread_num()] = sched_getcpu();
+    }
+
+    // deal the cores this rank was launched on out to its threads,
+    // wrapping around if there are more threads than cores.  returns
+    // the number of launched cores.
+    static std::size_t pin_threads ()
+    {
+      static cpu_set_t launched;
+      static bool have_launched = false;
+
+      if (!have_launched)
+        {
+          CPU_ZERO(&launched);
+          sched_getaffinity(0, sizeof(launched), &launched);
+          have_launched = true;
+        }
+
+      std::vector<int> cpus;
+      for (int c=0; c<CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &launched)) cpus.push_back(c);
+
+      if (cpus.empty()) return 0;
+
+#     pragma omp parallel
+      {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[omp_get_thread_num() % cpus.size()], &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+      }
+
+      return cpus.size();
+    }
+
+    void setup (const Context &, const std::size_t N)
+    {
+      matsize = N;
+      myflops.clear();
+      mysolveflops.clear();
+      mybw.clear();
+
+      // an eighth of a matrix per array is far beyond any cache, and
+      // first touch from the threads that will stream them.
+      triad_len = std::max<std::size_t>(N*N/8, 1 << 20);
+      ta.reset(new double[triad_len]);
+      tb.reset(new double[triad_len]);
+      tc.reset(new double[triad_len]);
+
+#     pragma omp parallel for schedule(static)
+      for (long i=0; i<static_cast<long>(triad_len); i++)
+        ta[i] = 0., tb[i] = 1., tc[i] = 2.;
+    }
+
+    void prepare (const std::size_t) {}
+
+    void execute ()
+    {
+      mysolveflops.push_back(dense_solve(matsize));
+      myflops.push_back(dense_matmul(matsize));
+      mybw.push_back(stream_triad());
+    }
+
+    void check (const std::size_t) const {}
+
+    double dense_matmul (const std::size_t N) const
+    {
+      Matrix A = Matrix::Random(N,N);
+
+      const double t_ops_start = MPI_Wtime();
+
+      Matrix A2 = A*A;
+
+      const double
+        t_end = MPI_Wtime(),
+        FLOP  = static_cast<double>( N*N*(2*N - 1) ),
+        FLOPS = FLOP / (t_end - t_ops_start);
+
+      if (0 == myrank) std::cout << "# GFLOPS: " << FLOPS / 1.e9 << "\n";
+
+      return FLOPS;
+    }
+
+    // LU factorization with partial pivoting plus the triangular
+    // solves, checked against a known solution.
+    double dense_solve (const std::size_t N) const
+    {
+      Matrix A = Matrix::Random(N, N);
+      Vector xtrue = Vector::Random(N);
+      Vector b = A*xtrue;
+
+      const double starttime = MPI_Wtime();
+
+      Vector xlu = A.partialPivLu().solve(b);
+
+      const double
+        t_end = MPI_Wtime(),
+        dN    = static_cast<double>(N),
+        FLOP  = 2./3.*dN*dN*dN + 2.*dN*dN,
+        FLOPS = FLOP / (t_end - starttime);
+
+      if (0 == myrank)
+        std::cout << "# Dense Solve GFLOPS: " << FLOPS / 1.e9
+                  << ", Relative Error: " << (A*xlu - b).norm() / b.norm() << "\n";
+
+      return FLOPS;
+    }
+
+    // bytes/sec, counting 3 doubles per element as STREAM does
+    double stream_triad ()
+    {
+      const double starttime = MPI_Wtime();
+
+#     pragma omp parallel for schedule(static)
+      for (long i=0; i<static_cast<long>(triad_len); i++)
+        ta[i] = tb[i] + 3.*tc[i];
+
+      const double BW = 3.*sizeof(double)*triad_len / (MPI_Wtime() - starttime);
+
+      if (0 == myrank) std::cout << "# triad GB/s: " << BW / 1.e9 << "\n";
+
+      return BW;
+    }
+
+    void describe (const Context &, const harness::Options &opts, harness::Sink &sink)
+    {
+      if (!sink.active()) return;
+
+      std::ostream &os = sink.stream();
+
+      os << "# OMP threads = " << omp_get_max_threads() << "\n"
+         << "# Eigen::nbThreads() = " << Eigen::nbThreads() << "\n"
+         << "# affinity = " << (std::getenv("OMP_PROC_BIND") ? "OMP_PROC_BIND" : "one core per thread")
+         << ", rank 0 thread cpus:";
+      for (auto it=thread_cpus.begin(); it!=thread_cpus.end(); ++it)
+        os << " " << *it;
+      os << "\n"
+         << "# omp_get_wtick() = " << omp_get_wtick() << "\n"
+         << "# *** running for walltime=" << opts.maxtime_global << " (sec) or nsteps=" << opts.maxstep << " (whichever first). ***\n"
+         << "# matsize = " << opts.bufcnt << " (elements)\n"
+         << "# triad = 3 x " << std::max<std::size_t>(opts.bufcnt*opts.bufcnt/8, 1 << 20) << " (doubles)" << std::endl;
+    }
+
+    template <typename T>
+    static double median (std::vector<T> v)
+    {
+      if (v.empty()) return 0.;
+      std::sort(v.begin(), v.end());
+      const std::size_t n = v.size();
+      return (n % 2) ? v[n/2] : 0.5*(v[n/2 - 1] + v[n/2]);
+    }
+
+    void report (const Context &ctx, const harness::StepStats &stats, harness::Sink &sink)
+    {
+      {
+        std::vector<double> avgtimes(ctx.nranks);
+        double myavg = stats.avg;
+        MPI_Allgather(&myavg,       1, MPI_DOUBLE,
+                      &avgtimes[0], 1, MPI_DOUBLE,
+                      MPI_COMM_WORLD);
+
+        const double medavg = median(avgtimes);
+
+        if (myavg > slow_threshold*medavg)
+          std::cout << "# *** " << ctx.host(ctx.myrank) << " SLOW: "
+                    << myavg << ", " << medavg << ", (" << myavg/medavg << ") ***\n";
+      }
+
+      // per-node sums of each rank's median step
+      const std::size_t nnodes = ctx.unique_hosts.size();
+      std::vector<double> local(3*nnodes, 0.), node(3*nnodes);
+
+      local[3*ctx.node_of[ctx.myrank] + 0] = median(myflops);
+      local[3*ctx.node_of[ctx.myrank] + 1] = median(mybw);
+      local[3*ctx.node_of[ctx.myrank] + 2] = median(mysolveflops);
+
+      MPI_Reduce(&local[0], &node[0], 3*nnodes, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+      if (!sink.active()) return;
+
+      std::ostream &os = sink.stream();
+
+      report_nodes(ctx, node, os);
+
+      std::sort(myflops.begin(), myflops.end());
+
+      int cnt=0;
+      os << "# my fastest steps (sec): ";
+      for (auto it = stats.times.begin(); it!=stats.times.end(); ++it)
+        {
+          if (cnt++ == 10) break;
+          os << *it << " (" << *it / stats.avg << ") ";
+        }
+      os << "\n";
+      cnt=0;
+      os << "# my slowest steps (GFLOPs): ";
+      for (auto it = myflops.rbegin(); it!=myflops.rend(); ++it)
+        {
+          if (cnt++ == 10) break;
+          os << *it / 1.e9 << " ";
+        }
+      os << "\n";
+      cnt=0;
+      os << "# my fastest steps (GFLOPs): ";
+      for (auto it = myflops.begin(); it!=myflops.end(); ++it)
+        {
+          if (cnt++ == 10) break;
+          os << *it / 1.e9 << " ";
+        }
+      os << std::endl;
+    }
+
+    // node_roofline rows, then nodes below the fleet median GEMM
+    // GFLOPS or triad GB/s (throttled cores, degraded DIMMs).
+    static void report_nodes (const Context &ctx, const std::vector<double> &node, std::ostream &os)
+    {
+      const std::size_t nnodes = ctx.unique_hosts.size();
+      std::vector<double> flops(nnodes), bw(nnodes);
+
+      for (std::size_t n=0; n<nnodes; n++)
+        flops[n] = node[3*n + 0], bw[n] = node[3*n + 1];
+
+      const double
+        medflops = median(flops),
+        medbw    = median(bw);
+
+      os << "# node_roofline=(host, GEMM GFLOPS, triad GB/s, GFLOPS/(GB/s), LU GFLOPS), summed over each node's ranks\n";
+
+      std::size_t n=0;
+      for (auto it=ctx.unique_hosts.begin(); it!=ctx.unique_hosts.end(); ++it, ++n)
+        os << "node_roofline=(\"" << *it << "\", "
+           << flops[n] / 1.e9 << ", "
+           << bw[n] / 1.e9 << ", "
+           << (bw[n] > 0. ? flops[n] / bw[n] : 0.) << ", "
+           << node[3*n + 2] / 1.e9 << ")\n";
+
+      os << "# fleet median: " << medflops / 1.e9 << " GFLOPS, " << medbw / 1.e9 << " GB/s per node\n";
+
+      n=0;
+      for (auto it=ctx.unique_hosts.begin(); it!=ctx.unique_hosts.end(); ++it, ++n)
+        {
+          if (flops[n]*slow_threshold < medflops)
+            os << "# *** " << *it << " SLOW GFLOPS: "
+               << flops[n] / 1.e9 << ", " << medflops / 1.e9 << ", (" << flops[n] / medflops << ") ***\n";
+          if (bw[n]*slow_threshold < medbw)
+            os << "# *** " << *it << " SLOW GB/s: "
+               << bw[n] / 1.e9 << ", " << medbw / 1.e9 << ", (" << bw[n] / medbw << ") ***\n";
+        }
+    }
+  };
+}
+
+#endif // DENSE_MATMUL_H
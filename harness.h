@@ -0,0 +1,692 @@
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include "mpi.h"
+#include <vector>
+#include <set>
+#include <map>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <assert.h>
+#include <unistd.h>
+
+#include "histogram.h"
+#include "noise.h"
+#include "records.h"
+
+// Header-only timing harness shared by the *_avg drivers and stress_suite.
+//
+// A benchmark is a small kernel class deriving from harness::KernelBase:
+//
+//   struct MyKernel : harness::KernelBase {
+//     static constexpr const char *name = "mykernel";
+//     std::size_t footprint (const Context &ctx, std::size_t bufcnt) const; // send buffer bytes
+//     void setup   (const Context &ctx, std::size_t bufcnt);               // (re)allocate for bufcnt
+//     void prepare (std::size_t step);                                     // untimed, before each step
+//     void execute ();                                                     // the timed operation
+//     void check   (std::size_t step);                                     // untimed, after each step
+//   };
+//
+// and harness::run() takes care of warmup, the timed step loop with its
+// MPI_Ibarrier timeout, message size sweeps, min/max reduction and output.
+namespace harness {
+
+  //----------------------------------------------------------------
+  // run-time options, shared by every driver:
+  //   --bufcnt N           fixed message size (elements)
+  //   --sweep              power-of-two message size sweep
+  //   --sweep-min BYTES    smallest sweep message (per peer)
+  //   --sweep-max BYTES    largest sweep message (per peer)
+  //   --sweep-time SEC     timing budget for each sweep size
+  //   --warmup N           untimed steps before each size
+  //   --maxstep N          upper bound on timed steps for each size
+  //   --maxtime SEC        wall-clock limit for each benchmark
+  //   --bench A,B,...      benchmarks to run (stress_suite only)
+  //   --records FILE       also write a binary record stream, see records.h
+  //   --mode MODE          collectives only: blocking (default), nonblocking
+  //                        or persistent, see collectives.h
+  //   --threads N          OpenMP threads per rank, compute kernels only
+  //                        (default: OMP_NUM_THREADS or the rank's cores)
+  //   --noise TYPE         also time each size under background load:
+  //                        stream, flops or burst (see noise.h)
+  //   --noise-cores N      cores to load per node (default: all idle cores)
+  //   --noise-burst US     busy time per burst period (burst only)
+  //   --noise-period US    burst period (burst only)
+  struct Options
+  {
+    std::size_t
+      bufcnt = 0,
+      maxstep = 0,
+      warmup = 0,
+      sweep_min_bytes = 1,
+      sweep_max_bytes = 1 << 25,
+      maxbufbytes = std::size_t(1) << 31; // per-buffer memory ceiling for sweep sizes
+
+    double
+      maxtime_global = 0.,
+      maxtime_size = 10.;
+
+    std::string mode, noise, records;
+    int
+      threads = 0,
+      noise_cores = 0,
+      noise_burst_us = 1000,
+      noise_period_us = 10000;
+
+    bool
+      sweep = false,
+      have_warmup = false;
+
+    std::vector<std::string> benchmarks;
+
+    void parse (int argc, char **argv)
+    {
+      for (int i=1; i<argc; i++)
+        {
+          const bool has_val = (i+1 < argc);
+
+          if      (0 == std::strcmp(argv[i], "--sweep"))                sweep = true;
+          else if (0 == std::strcmp(argv[i], "--bufcnt")     && has_val) bufcnt          = std::strtoull(argv[++i], nullptr, 10);
+          else if (0 == std::strcmp(argv[i], "--sweep-min")  && has_val) sweep_min_bytes = std::strtoull(argv[++i], nullptr, 10);
+          else if (0 == std::strcmp(argv[i], "--sweep-max")  && has_val) sweep_max_bytes = std::strtoull(argv[++i], nullptr, 10);
+          else if (0 == std::strcmp(argv[i], "--sweep-time") && has_val) maxtime_size    = std::strtod  (argv[++i], nullptr);
+          else if (0 == std::strcmp(argv[i], "--warmup")     && has_val) warmup          = std::strtoull(argv[++i], nullptr, 10), have_warmup = true;
+          else if (0 == std::strcmp(argv[i], "--maxstep")    && has_val) maxstep         = std::strtoull(argv[++i], nullptr, 10);
+          else if (0 == std::strcmp(argv[i], "--maxtime")    && has_val) maxtime_global  = std::strtod  (argv[++i], nullptr);
+          else if (0 == std::strcmp(argv[i], "--records")    && has_val) records         = argv[++i];
+          else if (0 == std::strcmp(argv[i], "--mode")       && has_val) mode            = argv[++i];
+          else if (0 == std::strcmp(argv[i], "--threads")    && has_val) threads         = std::atoi(argv[++i]);
+          else if (0 == std::strcmp(argv[i], "--noise")        && has_val) noise           = argv[++i];
+          else if (0 == std::strcmp(argv[i], "--noise-cores")  && has_val) noise_cores     = std::atoi(argv[++i]);
+          else if (0 == std::strcmp(argv[i], "--noise-burst")  && has_val) noise_burst_us  = std::atoi(argv[++i]);
+          else if (0 == std::strcmp(argv[i], "--noise-period") && has_val) noise_period_us = std::atoi(argv[++i]);
+          else if (0 == std::strcmp(argv[i], "--bench")      && has_val)
+            {
+              std::istringstream iss(argv[++i]);
+              for (std::string b; std::getline(iss, b, ',');)
+                if (!b.empty()) benchmarks.push_back(b);
+            }
+        }
+    }
+
+    // fill in anything not given on the command line from the kernel's defaults
+    template <class Kernel>
+    Options resolve () const
+    {
+      Options o(*this);
+
+      o.sweep = sweep && Kernel::sweepable;
+
+      if (0 == o.bufcnt)         o.bufcnt = Kernel::default_bufcnt;
+      if (0 == o.maxtime_global) o.maxtime_global = Kernel::default_maxtime;
+
+      // small messages need many more steps to fill the per-size budget
+      if (0 == o.maxstep)        o.maxstep = o.sweep ? 1e5 : Kernel::default_maxstep;
+      if (!o.have_warmup)        o.warmup  = o.sweep ? 10 : 0;
+      if (o.sweep)               o.warmup  = std::max(o.warmup, std::size_t(1));
+
+      // --bufcnt is shared by every kernel of a suite
+      o.bufcnt = std::max(o.bufcnt, Kernel::mincnt);
+
+      return o;
+    }
+  };
+
+
+
+  //----------------------------------------------------------------
+  // who and where we are.
+  struct Context
+  {
+    int nranks, myrank, nlocalranks, mylocalrank;
+
+    std::vector<char> hns;              // "global_rank:hostname:local_rank", 64 chars per rank
+    std::set<std::string> unique_hosts;
+    std::vector<int> node_of;           // index into unique_hosts, per rank
+
+    std::string host (const int r) const { return std::string(&hns[64*r]); }
+
+    void init ()
+    {
+      MPI_Comm_size (MPI_COMM_WORLD, &nranks);
+      MPI_Comm_rank (MPI_COMM_WORLD, &myrank);
+
+      hns.resize(64*nranks);
+
+      MPI_Comm shmcomm;
+      MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0,
+                          MPI_INFO_NULL, &shmcomm);
+      MPI_Comm_size(shmcomm, &nlocalranks);
+      MPI_Comm_rank(shmcomm, &mylocalrank);
+      MPI_Comm_free(&shmcomm);
+
+      char hn[64];
+      gethostname(hn, sizeof(hn) / sizeof(char));
+
+      // first step - undecorated hostnames
+      MPI_Allgather(&hn[0],  64, MPI_CHAR,
+                    &hns[0], 64, MPI_CHAR,
+                    MPI_COMM_WORLD);
+
+      for (auto r=0; r<nranks; r++)
+        unique_hosts.insert(std::string(&hns[r*64]));
+
+      std::map<std::string, int> node_idx;
+      for (auto it=unique_hosts.begin(); it!=unique_hosts.end(); ++it)
+        node_idx.insert(std::make_pair(*it, node_idx.size()));
+
+      node_of.resize(nranks);
+      for (auto r=0; r<nranks; r++)
+        node_of[r] = node_idx[std::string(&hns[r*64])];
+
+      // second step - "global_rank:hostname:local_rank"
+      std::ostringstream oss;
+      oss << myrank << ":" << hn << ":" << mylocalrank;
+      std::string str = oss.str();
+      assert (str.length() < 64);
+      str.resize(64, '\0');
+
+      MPI_Allgather(&str[0], 64, MPI_CHAR,
+                    &hns[0], 64, MPI_CHAR,
+                    MPI_COMM_WORLD);
+    }
+  };
+
+
+
+  //----------------------------------------------------------------
+  // per-step timings for one message size.  Every rank keeps a
+  // fixed-size histogram; raw step times are only kept where they are
+  // printed (rank 0, fixed-size runs).
+  struct StepStats
+  {
+    Histogram local, global;
+    std::vector<float> times, in_order;   // sorted by reduce(), and as timed
+    bool keep_times = false;
+    std::size_t steps = 0;
+
+    double
+      elapsed = 0.,
+      avg = 0.,
+      global_min = 0.,
+      global_max = 0.;
+
+    void push (const double t)
+    {
+      local.add(t);
+      if (keep_times) times.push_back(t);
+    }
+
+    // merge all ranks' histograms for the global distribution
+    void reduce (MPI_Comm comm)
+    {
+      in_order = times;
+      std::sort(times.begin(), times.end());
+
+      global = local.reduce(comm);
+      global_min = global.min();
+      global_max = global.max();
+    }
+
+    // global (all ranks, all steps) percentile
+    double percentile (const double q) const { return global.percentile(q); }
+  };
+
+
+
+  //----------------------------------------------------------------
+  // rank-0 text output, bracketed by the BEGIN/END markers the
+  // results-* Makefile targets look for.
+  class Sink
+  {
+  public:
+
+    Sink (const Context &ctx, std::ostream &os = std::cout) :
+      _ctx(ctx), _os(os)
+    {}
+
+    bool active () const { return 0 == _ctx.myrank; }
+
+    std::ostream & stream () { return _os; }
+
+    // rank 0 only; a no-op for an empty name
+    void open_records (const std::string &fname)
+    {
+      if (!active() || fname.empty()) return;
+
+      if (!_records.open(fname))
+        _os << "# cannot open records file \"" << fname << "\"" << std::endl;
+    }
+
+    // mode: the kernel's run_mode(), recorded only for kernels with modes
+    void begin (const char *exe, const char *bench, const Options *opts = nullptr, const char *mode = nullptr)
+    {
+      if (!active()) return;
+
+      time_t now = time(0);
+
+      if (_records.is_open())
+        {
+          std::string hosts;
+          for (auto it=_ctx.unique_hosts.begin(); it!=_ctx.unique_hosts.end(); ++it)
+            hosts += (hosts.empty() ? "" : ",") + *it;
+
+          records::Record rec(records::RUN);
+          rec.add("benchmark", std::string(bench))
+             .add("exe", std::string(exe))
+             .add("time", static_cast<uint64_t>(now))
+             .add("nranks", static_cast<uint64_t>(_ctx.nranks))
+             .add("nnodes", static_cast<uint64_t>(_ctx.unique_hosts.size()))
+             .add("ppn", static_cast<uint64_t>(_ctx.nlocalranks))
+             .add("hosts", hosts);
+          if (mode)
+            rec.add("mode", std::string(mode));
+          if (opts)
+            rec.add("sweep", static_cast<uint64_t>(opts->sweep))
+               .add("noise", opts->noise.empty() ? std::string("none") : opts->noise)
+               .add("warmup", static_cast<uint64_t>(opts->warmup))
+               .add("maxstep", static_cast<uint64_t>(opts->maxstep));
+          _records.write(rec);
+        }
+
+      _os << "# --> BEGIN execution\n"
+          << "# " << ctime(&now)
+          << "# " << exe << "\n"
+          << "# benchmark = " << bench << "\n"
+          << "# nranks = " << _ctx.nranks << "\n"
+          << "# nranks/node = " << _ctx.nlocalranks << "\n"
+          << "# nnodes = " << _ctx.unique_hosts.size() << "\n"
+          << "# MPI_Wtick() = " << MPI_Wtick() << "\n";
+
+      _os << "# unique hosts (" << _ctx.unique_hosts.size() << "): ";
+      for (auto it=_ctx.unique_hosts.begin(); it!=_ctx.unique_hosts.end(); ++it)
+        _os << *it << " ";
+      _os << "\n";
+    }
+
+    void sizes (const Options &opts, const std::vector<std::size_t> &sizes, const std::size_t elsize)
+    {
+      if (!active() || sizes.empty()) return;
+
+      if (opts.sweep)
+        _os << "# sweep = " << sizes.front()*elsize << " ... " << sizes.back()*elsize << " (bytes), "
+            << sizes.size() << " sizes, warmup = " << opts.warmup
+            << ", maxtime/size = " << opts.maxtime_size << " (sec)\n"
+            << "# sweep_row=(bufsize, steps, t_min, t_avg, t_max, p50, p90, p99, p99.9)"
+            << " (bytes, -, sec...), over all ranks and steps" << std::endl;
+      else
+        _os << "# bufcnt  = " << sizes.front()  << " (elements)\n"
+            << "# bufsize = " << sizes.front()*elsize << " (bytes)" << std::endl;
+    }
+
+    // tag distinguishes e.g. noise_row from the quiet sweep_row
+    void sweep_row (const std::size_t bufsize, const StepStats &stats, const char *tag = "sweep_row")
+    {
+      if (!active()) return;
+
+      _os << tag << "=("
+          << bufsize << ", "
+          << stats.local.count() << ", "
+          << stats.global_min << ", "
+          << stats.global.mean() << ", "
+          << stats.global_max << ", "
+          << stats.percentile(0.50) << ", "
+          << stats.percentile(0.90) << ", "
+          << stats.percentile(0.99) << ", "
+          << stats.percentile(0.999) << ")" << std::endl;
+    }
+
+    // python-literal step times, printed before sorting
+    void all_steps (const StepStats &stats, const char *tag = "all_steps")
+    {
+      if (!active()) return;
+
+      _os << "ranks_nodes_ppn=("
+          << _ctx.nranks << ","
+          << _ctx.unique_hosts.size() << ","
+          << _ctx.nlocalranks << ")\n";
+      _os << tag << "=np.array([";
+      for (auto it = stats.times.begin(); it!=stats.times.end(); ++it)
+        _os << *it << ", ";
+      _os << "])\n";
+    }
+
+    void summary (const StepStats &stats)
+    {
+      if (!active()) return;
+
+      _os << "# Elapsed Time = " << stats.elapsed << " (sec)\n"
+          << "# Fastest Step: t_min = " << stats.global_min << " (sec)\n"
+          << "# Slowest Step: t_max = " << stats.global_max << " (sec)\n"
+          << "# avg_time = " << stats.avg << " (sec)\n"
+          << "# total steps = " << stats.steps <<"\n"
+          << "# all ranks: p50 = " << stats.percentile(0.50)
+          << ", p90 = " << stats.percentile(0.90)
+          << ", p99 = " << stats.percentile(0.99)
+          << ", p99.9 = " << stats.percentile(0.999) << " (sec)\n";
+
+      int cnt=0;
+      _os << "# my slowest steps: ";
+      for (auto it = stats.times.rbegin(); it!=stats.times.rend(); ++it)
+        {
+          if (cnt++ == 10) break;
+          _os << *it << " (" << *it / stats.avg << ") ";
+        }
+      _os << "\n";
+    }
+
+    void noise (const Options &opts, const Noise &noise)
+    {
+      if (!active()) return;
+
+      _os << "# noise = " << noise.describe() << "\n";
+      if (opts.sweep)
+        _os << "# noise_row=(...) as sweep_row, timed with the load running" << std::endl;
+      else
+        _os << "# noise_steps=np.array(...) and the summary after it are timed with the load running" << std::endl;
+    }
+
+    // loaded/quiet ratios of the same size
+    void inflation (const std::size_t bufsize, const StepStats &quiet, const StepStats &loaded)
+    {
+      if (!active()) return;
+
+      auto ratio = [] (const double a, const double b) { return b > 0. ? a/b : 0.; };
+
+      _os << "# noise inflation @ " << bufsize << " (bytes): p50 x"
+          << ratio(loaded.percentile(0.50), quiet.percentile(0.50)) << ", p99 x"
+          << ratio(loaded.percentile(0.99), quiet.percentile(0.99)) << ", max x"
+          << ratio(loaded.global_max, quiet.global_max) << std::endl;
+    }
+
+    // one SIZE record; phase is "quiet", or "noise" for the loaded rerun
+    void record (const std::size_t bufsize, const char *phase, const StepStats &stats)
+    {
+      if (!active() || !_records.is_open()) return;
+
+      const Histogram::Sparse sp = stats.global.sparse();
+
+      records::Record rec(records::SIZE);
+      rec.add("bufsize", static_cast<uint64_t>(bufsize))
+         .add("phase", std::string(phase))
+         .add("steps", static_cast<uint64_t>(stats.steps))
+         .add("elapsed", stats.elapsed)
+         .add("count", sp.count)
+         .add("sum_ns", sp.sum)
+         .add("min_ns", sp.min)
+         .add("max_ns", sp.max)
+         .add("buckets", sp.buckets);
+      if (!stats.in_order.empty())
+        rec.add("rank0_times", stats.in_order); // step order
+      _records.write(rec);
+    }
+
+    void end ()
+    {
+      if (!active()) return;
+
+      _os << "# --> END execution" << std::endl;
+
+      if (_records.is_open())
+        _records.write(records::Record(records::END));
+    }
+
+  private:
+
+    const Context &_ctx;
+    std::ostream &_os;
+    records::Writer _records;
+  };
+
+
+
+  //----------------------------------------------------------------
+  // defaults for kernels, each of which may shadow any of these.
+  struct KernelBase
+  {
+    static constexpr std::size_t
+      elsize = sizeof(unsigned int),
+      mincnt = 1,
+      default_bufcnt = 1000,
+      default_maxstep = 5e2;
+
+    static constexpr double default_maxtime = 60.*10.;
+
+    static constexpr bool sweepable = true;
+
+    // once per run, on every rank, before anything is printed
+    void configure (const Context &, const Options &) {}
+
+    // after each setup, on every rank, before the warmup
+    void calibrate (const Context &) {}
+
+    // --mode as resolved by configure(), for kernels that have modes
+    const char * run_mode () const { return nullptr; }
+
+    // extra header lines, after the generic banner
+    void describe (const Context &, const Options &, Sink &) {}
+
+    // extra (collective) reporting after each size
+    void report (const Context &, const StepStats &, Sink &) {}
+  };
+
+
+
+  // power-of-two message sizes (in elements), rounding the byte bounds
+  // up to whole elements.
+  template <class Kernel>
+  std::vector<std::size_t> sweep_sizes (const Kernel &kernel, const Context &ctx, const Options &opts)
+  {
+    std::vector<std::size_t> sizes;
+
+    if (!opts.sweep)
+      return std::vector<std::size_t>(1, opts.bufcnt);
+
+    for (std::size_t bytes=1; bytes<=opts.sweep_max_bytes; bytes*=2)
+      {
+        if (bytes < opts.sweep_min_bytes) continue;
+
+        const std::size_t cnt = std::max(bytes / Kernel::elsize, Kernel::mincnt);
+
+        if (!sizes.empty() && sizes.back() == cnt) continue;
+        if (kernel.footprint(ctx, cnt) > opts.maxbufbytes) break;
+
+        sizes.push_back(cnt);
+      }
+
+    return sizes;
+  }
+
+
+
+  //----------------------------------------------------------------
+  // warmup + timed step loop for one message size.  returns false
+  // once a sweep has used up its global time budget.
+  template <class Kernel>
+  bool time_steps (Kernel &kernel, const Options &opts, const double starttime_run, StepStats &stats)
+  {
+    std::size_t step=0, nsteps=opts.maxstep;
+    int all_done=0;
+
+    MPI_Request barrier = MPI_REQUEST_NULL;
+
+    if (stats.keep_times)
+      stats.times.reserve(std::min(opts.maxstep, std::size_t(1e4)));
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    // untimed warmup, also used to size the step count so that
+    // every rank agrees on how many steps to issue.
+    if (opts.warmup)
+      {
+        const double starttime_warmup = MPI_Wtime();
+
+        for (std::size_t w=0; w<opts.warmup; w++)
+          kernel.execute();
+
+        double local[2] = { (MPI_Wtime() - starttime_warmup) / static_cast<double>(opts.warmup),
+                            (MPI_Wtime() - starttime_run) }, global[2];
+
+        MPI_Allreduce(local, global, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+        if (opts.sweep)
+          {
+            // stop the sweep once the global budget is used up
+            if (global[1] > opts.maxtime_global) return false;
+
+            const double budget = std::min(opts.maxtime_size, opts.maxtime_global - global[1]);
+            nsteps = std::max(std::size_t(10),
+                              std::min(opts.maxstep, static_cast<std::size_t>(budget / std::max(global[0], 1.e-9))));
+          }
+      }
+
+    const double starttime_global = MPI_Wtime();
+
+    while ((++step < nsteps) && (all_done == 0))
+      {
+        kernel.prepare(step);
+
+        const double starttime_step = MPI_Wtime();
+
+        kernel.execute();
+
+        // update timers & averages for this step
+        const double elapsedtime_step = (MPI_Wtime() - starttime_step);
+
+        stats.elapsed = (MPI_Wtime() - starttime_global);
+        stats.avg = stats.elapsed / static_cast<double>(step);
+        stats.push(elapsedtime_step);
+
+        // start nonblocking barrier if we've exceeded maxtime_global
+        // (sweep sizes have an agreed-upon step count instead.)
+        if (!opts.sweep && stats.elapsed > opts.maxtime_global)
+          {
+            if (MPI_REQUEST_NULL == barrier)
+              MPI_Ibarrier (MPI_COMM_WORLD, &barrier);
+
+            MPI_Test (&barrier, &all_done, MPI_STATUS_IGNORE);
+          }
+
+        kernel.check(step);
+      }
+
+    stats.steps = step;
+
+    return true;
+  }
+
+
+
+  //----------------------------------------------------------------
+  // one complete benchmark, BEGIN to END.
+  //
+  // with noise, every size is timed twice: quietly as usual, then
+  // again while the load threads run.
+  template <class Kernel>
+  void run (Kernel &kernel, const Context &ctx, const Options &cmdline, Sink &sink, const char *exe,
+            Noise *noise = nullptr)
+  {
+    const Options opts = cmdline.template resolve<Kernel>();
+
+    if (0 == ctx.myrank && opts.bufcnt != cmdline.bufcnt && 0 != cmdline.bufcnt)
+      std::cout << "# " << Kernel::name << " needs bufcnt >= " << Kernel::mincnt
+                << ", using " << opts.bufcnt << " instead of " << cmdline.bufcnt << std::endl;
+
+    const std::vector<std::size_t> sizes = sweep_sizes(kernel, ctx, opts);
+
+    kernel.configure(ctx, opts);
+
+    sink.begin(exe, Kernel::name, &opts, kernel.run_mode());
+    kernel.describe(ctx, opts, sink);
+    if (Kernel::sweepable) sink.sizes(opts, sizes, Kernel::elsize);
+    if (noise && noise->enabled()) sink.noise(opts, *noise);
+
+    const double starttime_run = MPI_Wtime();
+
+    for (auto sz=sizes.begin(); sz!=sizes.end(); ++sz)
+      {
+        StepStats stats;
+        stats.keep_times = sink.active() && !opts.sweep;
+
+        kernel.setup(ctx, *sz);
+        kernel.calibrate(ctx);
+
+        if (!time_steps(kernel, opts, starttime_run, stats)) break;
+
+        if (!opts.sweep) sink.all_steps(stats);
+
+        stats.reduce(MPI_COMM_WORLD);
+        sink.record(*sz*Kernel::elsize, "quiet", stats);
+
+        if (opts.sweep)
+          sink.sweep_row(*sz*Kernel::elsize, stats);
+        else
+          sink.summary(stats);
+
+        kernel.report(ctx, stats, sink);
+
+        if (!noise || !noise->enabled()) continue;
+
+        StepStats loaded;
+        loaded.keep_times = stats.keep_times;
+
+        noise->resume();
+        const bool in_budget = time_steps(kernel, opts, starttime_run, loaded);
+        noise->pause();
+
+        if (!in_budget) break;
+
+        if (!opts.sweep) sink.all_steps(loaded, "noise_steps");
+
+        loaded.reduce(MPI_COMM_WORLD);
+        sink.record(*sz*Kernel::elsize, "noise", loaded);
+
+        if (opts.sweep)
+          sink.sweep_row(*sz*Kernel::elsize, loaded, "noise_row");
+        else
+          sink.summary(loaded);
+
+        sink.inflation(*sz*Kernel::elsize, stats, loaded);
+      }
+
+    sink.end();
+  }
+
+
+
+  // main() for a single-kernel driver
+  template <class Kernel>
+  int main (int argc, char **argv)
+  {
+    Options opts;
+    opts.parse(argc, argv);
+
+    MPI_Init (&argc, &argv);
+
+    {
+      Context ctx;
+      ctx.init();
+
+      Sink sink(ctx);
+      sink.open_records(opts.records);
+      Kernel kernel;
+      Noise noise(Noise::parse_type(opts.noise, 0 == ctx.myrank), opts.noise_cores,
+                  opts.noise_burst_us, opts.noise_period_us);
+
+      run(kernel, ctx, opts, sink, argv[0], &noise);
+    }
+
+    MPI_Finalize();
+
+    return 0;
+  }
+}
+
+#endif // HARNESS_H
@@ -0,0 +1,189 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#ifndef HARNESS_NO_MPI
+#  include "mpi.h"
+#endif
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace harness {
+
+  //----------------------------------------------------------------
+  // Fixed-size, mergeable latency histogram with HDR-style log-linear
+  // buckets: values (in ns) below 2^subbits get one bucket each, and
+  // every power of two above that is split into 2^(subbits-1) buckets,
+  // so any recorded value is known to within 1/128 (0.8%) of itself.
+  // The largest bucket starts at 2^maxbits ns (~73 min); anything
+  // slower lands there.  Exact count/sum/min/max are kept alongside.
+  //
+  // Histograms from all ranks are merged with a single MPI_Allreduce
+  // using a custom MPI_Op, giving true cross-rank percentiles at a
+  // cost independent of how many steps were taken.
+  //
+  // Define HARNESS_NO_MPI for tools that only read histograms back
+  // from result files (see records.h).
+  class Histogram
+  {
+  public:
+
+    static constexpr int
+      subbits = 8,
+      maxbits = 42,
+      nbuckets = (maxbits - subbits + 3) << (subbits - 1);
+
+    Histogram () { clear(); }
+
+    void clear ()
+    {
+      _count = 0, _sum = 0;
+      _min = std::numeric_limits<uint64_t>::max(), _max = 0;
+      std::fill(_counts, _counts+nbuckets, 0);
+    }
+
+    // record one sample, in seconds
+    void add (const double t)
+    {
+      const uint64_t ns = static_cast<uint64_t>(std::max(t, 0.)*1.e9 + 0.5);
+
+      _count++;
+      _sum += ns;
+      _min = std::min(_min, ns);
+      _max = std::max(_max, ns);
+      _counts[bucket(ns)]++;
+    }
+
+    void merge (const Histogram &other)
+    {
+      _count += other._count;
+      _sum   += other._sum;
+      _min    = std::min(_min, other._min);
+      _max    = std::max(_max, other._max);
+      for (int b=0; b<nbuckets; b++)
+        _counts[b] += other._counts[b];
+    }
+
+    uint64_t count () const { return _count; }
+
+    // everything below in seconds
+    double min  () const { return _count ? 1.e-9*_min : 0.; }
+    double max  () const { return 1.e-9*_max; }
+    double mean () const { return _count ? 1.e-9*_sum / static_cast<double>(_count) : 0.; }
+
+    // smallest recorded value v such that a fraction q of all samples
+    // are <= v, to bucket resolution (and clamped to the exact min/max).
+    double percentile (const double q) const
+    {
+      if (0 == _count) return 0.;
+
+      const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q*_count)));
+
+      uint64_t cumulative = 0;
+      for (int b=0; b<nbuckets; b++)
+        if ((cumulative += _counts[b]) >= rank)
+          return 1.e-9*std::min(std::max(midpoint(b), _min), _max);
+
+      return max();
+    }
+
+    // compact form for result files: the exact totals (ns) and the
+    // non-empty buckets as (index, count).
+    struct Sparse
+    {
+      uint64_t count, sum, min, max;
+      std::vector<std::pair<uint32_t, uint64_t> > buckets;
+    };
+
+    Sparse sparse () const
+    {
+      Sparse sp = { _count, _sum, _min, _max, {} };
+      for (int b=0; b<nbuckets; b++)
+        if (_counts[b]) sp.buckets.push_back(std::make_pair(b, _counts[b]));
+      return sp;
+    }
+
+    static Histogram from_sparse (const Sparse &sp)
+    {
+      Histogram h;
+      h._count = sp.count, h._sum = sp.sum, h._min = sp.min, h._max = sp.max;
+      for (auto it=sp.buckets.begin(); it!=sp.buckets.end(); ++it)
+        if (it->first < static_cast<uint32_t>(nbuckets)) h._counts[it->first] = it->second;
+      return h;
+    }
+
+#ifndef HARNESS_NO_MPI
+    // merge the histograms of every rank in comm.
+    Histogram reduce (MPI_Comm comm) const
+    {
+      Histogram global;
+      MPI_Allreduce(this, &global, 1, mpi_type(), mpi_op(), comm);
+      return global;
+    }
+#endif
+
+  private:
+
+    static int bucket (const uint64_t ns)
+    {
+      if (ns < (uint64_t(1) << subbits)) return ns;
+
+      const int e = std::min(63 - __builtin_clzll(ns), maxbits);
+      const uint64_t m = std::min(ns >> (e - subbits + 1), (uint64_t(1) << subbits) - 1);
+
+      return ((e - subbits + 2) << (subbits - 1)) + (m - (uint64_t(1) << (subbits - 1)));
+    }
+
+    static uint64_t midpoint (const int b)
+    {
+      if (b < (1 << subbits)) return b;
+
+      const int
+        half = 1 << (subbits - 1),
+        e = b / half + subbits - 2,
+        shift = e - subbits + 1;
+      const uint64_t m = half + b % half;
+
+      return (m << shift) + (uint64_t(1) << shift) / 2;
+    }
+
+#ifndef HARNESS_NO_MPI
+    static void merge_op (void *in, void *inout, int *len, MPI_Datatype *)
+    {
+      const Histogram *src = static_cast<const Histogram *>(in);
+      Histogram *dst = static_cast<Histogram *>(inout);
+
+      for (int i=0; i<*len; i++)
+        dst[i].merge(src[i]);
+    }
+
+    // created on first use and kept until MPI_Finalize.
+    static MPI_Datatype mpi_type ()
+    {
+      static MPI_Datatype type = MPI_DATATYPE_NULL;
+      if (MPI_DATATYPE_NULL == type)
+        {
+          MPI_Type_contiguous(sizeof(Histogram), MPI_BYTE, &type);
+          MPI_Type_commit(&type);
+        }
+      return type;
+    }
+
+    static MPI_Op mpi_op ()
+    {
+      static MPI_Op op = MPI_OP_NULL;
+      if (MPI_OP_NULL == op)
+        MPI_Op_create(&merge_op, /* commute = */ 1, &op);
+      return op;
+    }
+#endif
+
+    uint64_t _count, _sum, _min, _max;
+    uint64_t _counts[nbuckets];
+  };
+}
+
+#endif // HISTOGRAM_H
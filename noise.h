@@ -0,0 +1,303 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include "mpi.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+
+namespace harness {
+
+  //----------------------------------------------------------------
+  // Background interference on otherwise idle cores, so collective
+  // step times can be compared with and without on-node load.
+  //
+  // The cores no rank on this node is bound to are dealt out round-robin
+  // to the local ranks, each of which pins one load thread per core it
+  // gets.  If every core is already taken (e.g. 128 ppn on 128 cores)
+  // each rank starts one thread that may run anywhere but on its own
+  // core(s), i.e. it competes with the other ranks.
+  //
+  // Threads start paused; resume()/pause() bracket the loaded phase
+  // and return only once every thread is running, or parked.  The
+  // load loops check in every ~100us, so no load spills past pause().
+  // The threads never call MPI.
+  class Noise
+  {
+  public:
+
+    enum Type { NONE, STREAM, FLOPS, BURST };
+
+    // warn: print a note for unknown names (rank 0)
+    static Type parse_type (const std::string &s, const bool warn = false)
+    {
+      if ("stream" == s) return STREAM;
+      if ("flops"  == s) return FLOPS;
+      if ("burst"  == s) return BURST;
+
+      if (warn && !s.empty() && "none" != s)
+        std::cout << "# unknown noise \"" << s << "\", running without load" << std::endl;
+      return NONE;
+    }
+
+    static const char * type_name (const Type t)
+    {
+      switch (t)
+        {
+        case STREAM: return "stream";
+        case FLOPS:  return "flops";
+        case BURST:  return "burst";
+        default:     return "none";
+        }
+    }
+
+    // max_cores: cores to load per node, 0 for every free core.
+    // burst_us/period_us: busy time per period for BURST.
+    Noise (const Type type, const int max_cores, const int burst_us, const int period_us) :
+      _type(type), _burst_us(burst_us), _period_us(period_us), _state(PAUSED), _shared(false)
+    {
+      if (NONE == _type) return;
+
+      MPI_Comm shmcomm;
+      int nlocal, mylocal;
+      MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &shmcomm);
+      MPI_Comm_size(shmcomm, &nlocal);
+      MPI_Comm_rank(shmcomm, &mylocal);
+
+      // which cores are the ranks on this node bound to?
+      cpu_set_t mine;
+      CPU_ZERO(&mine);
+      sched_getaffinity(0, sizeof(mine), &mine);
+
+      std::vector<cpu_set_t> all(nlocal);
+      MPI_Allgather(&mine,   sizeof(cpu_set_t), MPI_BYTE,
+                    &all[0], sizeof(cpu_set_t), MPI_BYTE, shmcomm);
+
+      const int ncpus = std::min<int>(sysconf(_SC_NPROCESSORS_ONLN), CPU_SETSIZE);
+
+      std::vector<int> free_cpus;
+      for (int c=0; c<ncpus; c++)
+        {
+          bool used = false;
+          for (int r=0; r<nlocal && !used; r++)
+            used = CPU_ISSET(c, &all[r]);
+          if (!used) free_cpus.push_back(c);
+        }
+
+      if (max_cores > 0 && free_cpus.size() > static_cast<std::size_t>(max_cores))
+        free_cpus.resize(max_cores);
+
+      if (!free_cpus.empty())
+        for (std::size_t i=mylocal; i<free_cpus.size(); i+=nlocal)
+          {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(free_cpus[i], &set);
+            spawn(set);
+          }
+      else
+        {
+          cpu_set_t set;
+          CPU_ZERO(&set);
+          for (int c=0; c<ncpus; c++)
+            if (!CPU_ISSET(c, &mine)) CPU_SET(c, &set);
+          _shared = true;
+          if (CPU_COUNT(&set)) spawn(set);
+        }
+
+      // threads actually started: per node, then the fewest and most
+      // over all nodes.  an unbound rank has no cores to share.
+      int mythreads = _threads.size(), node = 0, range[2], myrank;
+      MPI_Allreduce(&mythreads, &node, 1, MPI_INT, MPI_SUM, shmcomm);
+      MPI_Comm_free(&shmcomm);
+
+      MPI_Allreduce(&node, &range[0], 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+      MPI_Allreduce(&node, &range[1], 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+      _node_threads[0] = range[0], _node_threads[1] = range[1];
+
+      MPI_Comm_rank(MPI_COMM_WORLD, &myrank);
+
+      if (0 == range[1])
+        {
+          if (0 == myrank)
+            std::cout << "# noise: no load threads could be started (no idle cores, ranks not bound), running without load" << std::endl;
+          _type = NONE;
+        }
+      else if (0 == range[0] && 0 == myrank)
+        std::cout << "# noise: some nodes have no load threads" << std::endl;
+    }
+
+    ~Noise ()
+    {
+      set_state(EXIT);
+      for (auto it=_threads.begin(); it!=_threads.end(); ++it)
+        it->join();
+    }
+
+    bool enabled () const { return NONE != _type; }
+
+    void resume () { set_state(RUNNING); wait_count(_threads.size()); }
+    void pause  () { set_state(PAUSED);  wait_count(0); }
+
+    // e.g. "stream, 64 thread(s)/node, pinned to idle cores" for the header
+    std::string describe () const
+    {
+      std::ostringstream oss;
+      oss << type_name(_type) << ", " << _node_threads[0];
+      if (_node_threads[1] != _node_threads[0]) oss << "-" << _node_threads[1];
+      oss << " thread(s)/node, "
+          << (_shared ? "sharing rank cores (no idle cores)" : "pinned to idle cores");
+      if (BURST == _type)
+        oss << ", " << _burst_us << "/" << _period_us << " (us busy/period)";
+      return oss.str();
+    }
+
+  private:
+
+    enum State { PAUSED, RUNNING, EXIT };
+
+    void set_state (const State s)
+    {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _state = s;
+      }
+      _cv.notify_all();
+    }
+
+    // until exactly n threads are running
+    void wait_count (const std::size_t n)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait(lock, [this, n]{ return n == _running; });
+    }
+
+    bool running () const { return RUNNING == _state.load(std::memory_order_relaxed); }
+
+    // called between chunks of load: park while paused, keeping
+    // _running up to date; false once we should exit.  active is the
+    // calling thread's own view of whether it is counted as running.
+    bool wait_running (bool &active)
+    {
+      if (active && running()) return true;
+
+      std::unique_lock<std::mutex> lock(_mutex);
+      if (active)
+        {
+          active = false;
+          _running--;
+          _cv.notify_all();
+        }
+
+      _cv.wait(lock, [this]{ return PAUSED != _state.load(); });
+      if (EXIT == _state.load()) return false;
+
+      active = true;
+      _running++;
+      _cv.notify_all();
+      return true;
+    }
+
+    // sleep until t, waking early if paused
+    template <typename TimePoint>
+    void idle_until (const TimePoint &t)
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait_until(lock, t, [this]{ return RUNNING != _state.load(); });
+    }
+
+    void spawn (const cpu_set_t &set) { _threads.emplace_back(&Noise::work, this, set); }
+
+    // keeps the loads from being optimized away
+    static void consume (const double v) { volatile double sink = v; (void) sink; }
+
+    // pin first, so the stream arrays are first touched on our own
+    // NUMA domain
+    void work (const cpu_set_t set)
+    {
+      pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+      switch (_type)
+        {
+        case STREAM: stream(); break;
+        case FLOPS:  flops();  break;
+        case BURST:  burst();  break;
+        default: break;
+        }
+    }
+
+    // STREAM triad over arrays well beyond any cache, a chunk at a time
+    void stream ()
+    {
+      const std::size_t n = 1 << 21, chunk = 1 << 15; // 16 MB per array
+      std::vector<double> a(n, 0.), b(n, 1.), c(n, 2.);
+      std::size_t lo = 0;
+      bool active = false;
+
+      while (wait_running(active))
+        {
+          const std::size_t hi = std::min(lo + chunk, n);
+          for (std::size_t i=lo; i<hi; i++)
+            a[i] = b[i] + 3.*c[i];
+          lo = (n == hi) ? 0 : hi;
+        }
+
+      consume(a[n/2]);
+    }
+
+    // register-resident multiply-adds, several independent chains
+    void flops ()
+    {
+      double x[8] = { 1., 2., 3., 4., 5., 6., 7., 8. };
+      bool active = false;
+
+      while (wait_running(active))
+        for (int it=0; it<(1 << 12); it++)
+          for (int j=0; j<8; j++)
+            x[j] = x[j]*0.999999 + 1.e-6;
+
+      consume(x[0] + x[1] + x[2] + x[3] + x[4] + x[5] + x[6] + x[7]);
+    }
+
+    // periodic busy bursts, like a daemon waking up
+    void burst ()
+    {
+      typedef std::chrono::steady_clock clock;
+      bool active = false;
+
+      while (wait_running(active))
+        {
+          const clock::time_point start = clock::now();
+
+          while (running() && clock::now() - start < std::chrono::microseconds(_burst_us))
+            ;
+
+          idle_until(start + std::chrono::microseconds(_period_us));
+        }
+    }
+
+    Type _type;
+    const int _burst_us, _period_us;
+
+    std::atomic<int> _state;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::size_t _running = 0;           // threads out of wait_running(), under _mutex
+
+    std::vector<std::thread> _threads;
+    int _node_threads[2] = { 0, 0 };    // fewest and most threads on a node
+    bool _shared;
+  };
+}
+
+#endif // NOISE_H
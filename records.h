@@ -0,0 +1,306 @@
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <sys/stat.h>
+
+namespace harness {
+
+  //----------------------------------------------------------------
+  // Self-describing binary result stream, written by rank 0 next to
+  // the text output (--records FILE) and read back by
+  // aggregate_records.  Native endianness, little on all our systems:
+  //
+  //   file:     "MPIRECS1", then records until EOF
+  //   record:   uint32 type, uint32 nfields, uint64 nbytes, payload
+  //   payload:  nfields x (uint8 keylen, key, uint8 field type,
+  //                        uint32 value bytes, value)
+  //   values:   U64      uint64
+  //             F64      double
+  //             STR      uint32 len, chars
+  //             F32S     uint64 n, n floats
+  //             BUCKETS  uint64 n, n x (uint32 index, uint64 count)
+  //
+  // A run is RUN (metadata), one SIZE per message size and phase
+  // (histogram over all ranks and steps), then END.  Every record is
+  // flushed as it is written, so a killed job leaves its completed
+  // sizes readable; a missing END marks the run partial, and a torn
+  // last record is dropped.  Readers skip record types and fields they
+  // do not know, by the record and value byte counts.
+  namespace records {
+
+    static const char magic[8] = { 'M','P','I','R','E','C','S','1' };
+
+    enum RecordType : uint32_t { RUN = 1, SIZE = 2, END = 3 };
+    enum FieldType  : uint8_t  { U64 = 0, F64 = 1, STR = 2, F32S = 3, BUCKETS = 4 };
+
+    struct Field
+    {
+      std::string key;
+      FieldType type;
+      uint64_t u = 0;
+      double f = 0.;
+      std::string s;
+      std::vector<float> v;
+      std::vector<std::pair<uint32_t, uint64_t> > b;
+    };
+
+    struct Record
+    {
+      uint32_t type = 0;
+      std::vector<Field> fields;
+
+      explicit Record (const uint32_t t = 0) : type(t) {}
+
+      Record & add (const std::string &key, const uint64_t u)           { Field fld; fld.key = key, fld.type = U64, fld.u = u; fields.push_back(fld); return *this; }
+      Record & add (const std::string &key, const double f)             { Field fld; fld.key = key, fld.type = F64, fld.f = f; fields.push_back(fld); return *this; }
+      Record & add (const std::string &key, const std::string &s)       { Field fld; fld.key = key, fld.type = STR, fld.s = s; fields.push_back(fld); return *this; }
+      Record & add (const std::string &key, const std::vector<float> &v) { Field fld; fld.key = key, fld.type = F32S, fld.v = v; fields.push_back(fld); return *this; }
+      Record & add (const std::string &key, const std::vector<std::pair<uint32_t, uint64_t> > &b)
+      { Field fld; fld.key = key, fld.type = BUCKETS, fld.b = b; fields.push_back(fld); return *this; }
+
+      const Field * find (const std::string &key) const
+      {
+        for (auto it=fields.begin(); it!=fields.end(); ++it)
+          if (it->key == key) return &*it;
+        return nullptr;
+      }
+
+      uint64_t    u64 (const std::string &key, const uint64_t def = 0)          const { const Field *f = find(key); return (f && U64 == f->type) ? f->u : def; }
+      double      f64 (const std::string &key, const double def = 0.)           const { const Field *f = find(key); return (f && F64 == f->type) ? f->f : def; }
+      std::string str (const std::string &key, const std::string &def = "")     const { const Field *f = find(key); return (f && STR == f->type) ? f->s : def; }
+    };
+
+
+
+    class Writer
+    {
+    public:
+
+      ~Writer () { close(); }
+
+      bool open (const std::string &fname)
+      {
+        close();
+        _fp = std::fopen(fname.c_str(), "wb");
+        if (_fp) put(magic, sizeof(magic)), std::fflush(_fp);
+        return _fp;
+      }
+
+      void close ()
+      {
+        if (_fp) std::fclose(_fp);
+        _fp = nullptr;
+      }
+
+      bool is_open () const { return _fp; }
+
+      void write (const Record &rec)
+      {
+        if (!_fp) return;
+
+        _buf.clear();
+        for (auto it=rec.fields.begin(); it!=rec.fields.end(); ++it)
+          encode(*it);
+
+        const uint32_t hdr[2] = { rec.type, static_cast<uint32_t>(rec.fields.size()) };
+        const uint64_t nbytes = _buf.size();
+
+        put(hdr, sizeof(hdr));
+        put(&nbytes, sizeof(nbytes));
+        put(_buf.data(), _buf.size());
+        std::fflush(_fp);
+      }
+
+    private:
+
+      void put (const void *p, const std::size_t n) { std::fwrite(p, 1, n, _fp); }
+
+      template <typename T>
+      void append (const T &val) { append(&val, sizeof(T)); }
+      void append (const void *p, const std::size_t n)
+      {
+        const char *c = static_cast<const char *>(p);
+        _buf.insert(_buf.end(), c, c+n);
+      }
+
+      void encode (const Field &f)
+      {
+        const uint8_t keylen = static_cast<uint8_t>(std::min<std::size_t>(f.key.size(), 255));
+        append(keylen);
+        append(f.key.data(), keylen);
+        append(static_cast<uint8_t>(f.type));
+
+        // value bytes, filled in once the value is encoded
+        const std::size_t lenpos = _buf.size();
+        append(static_cast<uint32_t>(0));
+
+        switch (f.type)
+          {
+          case U64: append(f.u); break;
+          case F64: append(f.f); break;
+          case STR:
+            append(static_cast<uint32_t>(f.s.size()));
+            append(f.s.data(), f.s.size());
+            break;
+          case F32S:
+            append(static_cast<uint64_t>(f.v.size()));
+            append(f.v.data(), f.v.size()*sizeof(float));
+            break;
+          case BUCKETS:
+            append(static_cast<uint64_t>(f.b.size()));
+            for (auto it=f.b.begin(); it!=f.b.end(); ++it)
+              append(it->first), append(it->second);
+            break;
+          }
+
+        const uint32_t len = static_cast<uint32_t>(_buf.size() - lenpos - sizeof(uint32_t));
+        std::memcpy(&_buf[lenpos], &len, sizeof(len));
+      }
+
+      std::FILE *_fp = nullptr;
+      std::vector<char> _buf;
+    };
+
+
+
+    class Reader
+    {
+    public:
+
+      ~Reader () { if (_fp) std::fclose(_fp); }
+
+      // false if the file is missing or not a record stream
+      bool open (const std::string &fname)
+      {
+        char m[sizeof(magic)];
+        struct stat st;
+        _fp = std::fopen(fname.c_str(), "rb");
+        if (!_fp || 0 != fstat(fileno(_fp), &st)) return false;
+        _size = st.st_size;
+        return (1 == std::fread(m, sizeof(m), 1, _fp)) && (0 == std::memcmp(m, magic, sizeof(m)));
+      }
+
+      // next complete record; false at EOF or at a torn record
+      bool next (Record &rec)
+      {
+        uint32_t hdr[2];
+        uint64_t nbytes;
+        char raw[sizeof(hdr) + sizeof(nbytes)];
+
+        // nothing at all is a clean EOF, part of a header is not
+        const std::size_t got = std::fread(raw, 1, sizeof(raw), _fp);
+        if (sizeof(raw) != got)
+          {
+            if (got) _torn = true;
+            return false;
+          }
+        std::memcpy(hdr, raw, sizeof(hdr));
+        std::memcpy(&nbytes, raw + sizeof(hdr), sizeof(nbytes));
+
+        // a garbage length must not be trusted with an allocation
+        const long pos = std::ftell(_fp);
+        if (pos < 0 || nbytes > _size - static_cast<uint64_t>(pos))
+          {
+            _torn = true;
+            return false;
+          }
+
+        _buf.resize(nbytes);
+        if (nbytes && 1 != std::fread(&_buf[0], nbytes, 1, _fp))
+          {
+            _torn = true;
+            return false;
+          }
+
+        rec = Record(hdr[0]);
+        _pos = 0;
+
+        for (uint32_t i=0; i<hdr[1]; i++)
+          if (!decode(rec))
+            {
+              _torn = true;
+              return false;
+            }
+
+        return true;
+      }
+
+      bool torn () const { return _torn; }
+
+    private:
+
+      bool take (void *p, const std::size_t n)
+      {
+        if (_pos + n > _buf.size()) return false;
+        std::memcpy(p, &_buf[_pos], n);
+        _pos += n;
+        return true;
+      }
+
+      template <typename T>
+      bool take (T &val) { return take(&val, sizeof(T)); }
+
+      bool decode (Record &rec)
+      {
+        Field f;
+        uint8_t keylen, type;
+        uint32_t len, vbytes;
+        uint64_t n;
+
+        if (!take(keylen)) return false;
+        f.key.resize(keylen);
+        if (keylen && !take(&f.key[0], keylen)) return false;
+        if (!take(type) || !take(vbytes)) return false;
+        if (_pos + vbytes > _buf.size()) return false;
+        f.type = static_cast<FieldType>(type);
+
+        const std::size_t end = _pos + vbytes;
+
+        switch (f.type)
+          {
+          case U64: if (!take(f.u)) return false; break;
+          case F64: if (!take(f.f)) return false; break;
+          case STR:
+            if (!take(len)) return false;
+            f.s.resize(len);
+            if (len && !take(&f.s[0], len)) return false;
+            break;
+          case F32S:
+            if (!take(n) || n > _buf.size()) return false;
+            f.v.resize(n);
+            if (n && !take(&f.v[0], n*sizeof(float))) return false;
+            break;
+          case BUCKETS:
+            if (!take(n) || n > _buf.size()) return false;
+            f.b.resize(n);
+            for (auto it=f.b.begin(); it!=f.b.end(); ++it)
+              if (!take(it->first) || !take(it->second)) return false;
+            break;
+          default:                        // unknown field type: skip it
+            _pos = end;
+            return true;
+          }
+
+        if (_pos != end) return false;
+
+        rec.fields.push_back(f);
+        return true;
+      }
+
+      std::FILE *_fp = nullptr;
+      std::vector<char> _buf;
+      std::size_t _pos = 0;
+      uint64_t _size = 0;               // file bytes
+      bool _torn = false;
+    };
+  }
+}
+
+#endif // RECORDS_H